@@ -0,0 +1,121 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+/*
+ * Compile-time footprint profiles.
+ *
+ * PROFILE_FULL (default) is meant for Falcon/TT machines: HTML UI, remote
+ * terminal and every route. PROFILE_MINIMAL is an API-only build for 1 MB
+ * STs: no embedded HTML/CSS/JS, no /exec, small buffers and a short queue.
+ *
+ * Every value below can also be overridden on its own with -DNAME=value.
+ */
+#if defined(PROFILE_MINIMAL) && defined(PROFILE_FULL)
+#error "Select only one of PROFILE_MINIMAL and PROFILE_FULL"
+#endif
+
+#if defined(PROFILE_MINIMAL)
+
+#ifndef FEATURE_HTML_UI
+#define FEATURE_HTML_UI 0
+#endif
+#ifndef FEATURE_EXEC
+#define FEATURE_EXEC 0
+#endif
+#ifndef RECV_BUF_SIZE
+#define RECV_BUF_SIZE 2048
+#endif
+#ifndef MAX_HEADER_SIZE
+#define MAX_HEADER_SIZE 2048
+#endif
+#ifndef IO_BUF_SIZE
+#define IO_BUF_SIZE 1024
+#endif
+#ifndef MAX_QUEUED_CONNS
+#define MAX_QUEUED_CONNS 2
+#endif
+
+#endif /* PROFILE_MINIMAL */
+
+/* Routes */
+#ifndef FEATURE_HTML_UI
+#define FEATURE_HTML_UI 1
+#endif
+#ifndef FEATURE_EXEC
+#define FEATURE_EXEC 1
+#endif
+#ifndef FEATURE_UPLOAD
+#define FEATURE_UPLOAD 1
+#endif
+#ifndef FEATURE_DELETE
+#define FEATURE_DELETE 1
+#endif
+#ifndef FEATURE_TAIL
+#define FEATURE_TAIL 1
+#endif
+#ifndef FEATURE_STATS
+#define FEATURE_STATS 1
+#endif
+
+/* Buffers. RECV_BUF_SIZE lives on the stack of handle_client(); IO_BUF_SIZE
+ * is the chunk size for file transfers; EXEC_MAX_OUTPUT is malloc'd per
+ * /exec call. */
+#ifndef RECV_BUF_SIZE
+#define RECV_BUF_SIZE 16384
+#endif
+#ifndef IO_BUF_SIZE
+#define IO_BUF_SIZE 4096
+#endif
+#ifndef EXEC_MAX_OUTPUT
+#define EXEC_MAX_OUTPUT 65536
+#endif
+
+/* /api/tail follow mode: how often the file size is polled and how long a
+ * single follow request may hold the connection before it is ended. */
+#ifndef TAIL_POLL_INTERVAL_MS
+#define TAIL_POLL_INTERVAL_MS 500
+#endif
+#ifndef TAIL_MAX_HOLD_SEC
+#define TAIL_MAX_HOLD_SEC 300
+#endif
+
+/* Per-connection deadlines. The server handles one client at a time, so a
+ * silent peer must never be allowed to block in recv()/send() forever. */
+#ifndef HEADER_TIMEOUT_MS
+#define HEADER_TIMEOUT_MS 5000
+#endif
+#ifndef BODY_IDLE_TIMEOUT_MS
+#define BODY_IDLE_TIMEOUT_MS 10000
+#endif
+#ifndef REQUEST_TIMEOUT_MS
+#define REQUEST_TIMEOUT_MS 600000L
+#endif
+/* /exec commands still running after this are killed */
+#ifndef EXEC_TIMEOUT_MS
+#define EXEC_TIMEOUT_MS 60000L
+#endif
+/* Uploads slower than this (after the grace period) are dropped */
+#ifndef UPLOAD_MIN_BYTES_PER_SEC
+#define UPLOAD_MIN_BYTES_PER_SEC 256L
+#endif
+#ifndef UPLOAD_GRACE_MS
+#define UPLOAD_GRACE_MS 10000L
+#endif
+
+/* Admission control: accepted connections wait in a small FIFO while
+ * another client is served; overflow and stale entries get an early 503. */
+#ifndef MAX_QUEUED_CONNS
+#define MAX_QUEUED_CONNS 8
+#endif
+#ifndef MAX_QUEUE_WAIT_MS
+#define MAX_QUEUE_WAIT_MS 15000L
+#endif
+#ifndef MAX_HEADER_SIZE
+#define MAX_HEADER_SIZE 8192
+#endif
+
+#if MAX_HEADER_SIZE > RECV_BUF_SIZE
+#error "MAX_HEADER_SIZE must not exceed RECV_BUF_SIZE"
+#endif
+
+#endif /* CONFIG_H */
@@ -7,26 +7,78 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
-/* Some MiNT headers may lack popen prototypes */
-extern FILE *popen(const char *command, const char *type);
-extern int pclose(FILE *stream);
+#include "config.h"
+
+#if FEATURE_EXEC
+/* Some MiNT headers may lack a kill prototype under -std=c11 */
+extern int kill(pid_t pid, int sig);
+#endif
 
 #define LISTEN_PORT 80
-#define LISTEN_BACKLOG 4
-#define RECV_BUF_SIZE 16384
+#define LISTEN_BACKLOG MAX_QUEUED_CONNS
 #define SERVER_NAME "mint-http-fm"
 
+#define IO_TIMED_OUT (-2)
+#define RECV_TOO_LARGE (-3)
+
+/* Largest single send() after select() reports the socket writable; small
+ * enough to fit the usual send low-water mark, so it does not block even
+ * on stacks without SO_SNDTIMEO. Only used on such stacks. */
+#define SEND_CHUNK 1024
+/* How often full-buffer sends stop to move new connections into the queue */
+#define SEND_ACCEPT_POLL_MS 200
+
 struct entry {
     char *name;
     int is_dir;
     long size;
 };
 
+struct pending_conn {
+    int fd;
+    int has_sndtimeo;
+    struct timeval accepted_at;
+};
+
+struct conn_queue {
+    int listen_fd;
+    struct pending_conn items[MAX_QUEUED_CONNS];
+    size_t head;
+    size_t count;
+};
+
+struct server_stats {
+    unsigned long accepted;
+    unsigned long served;
+    unsigned long timed_out;
+    unsigned long rejected;
+};
+
+static struct conn_queue queue = {-1, {{0}}, 0, 0};
+static struct server_stats stats;
+
+/* Deadline of the request being served; every send_all() is bounded by it */
+static struct timeval request_start;
+static int request_timed_out;
+static int request_has_sndtimeo;
+
+static void accept_pending(void);
+
+static long elapsed_ms(const struct timeval *since) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (long)(now.tv_sec - since->tv_sec) * 1000L + (long)(now.tv_usec - since->tv_usec) / 1000L;
+}
+
 static char *str_dup(const char *s) {
     size_t len = strlen(s) + 1;
     char *p = (char *)malloc(len);
@@ -90,19 +142,127 @@ static int normalize_path(const char *url_path, char *out, size_t out_sz) {
     return 0;
 }
 
-static int send_all(int fd, const void *data, size_t len) {
+/* Waits until fd is readable (or writable), bounded by idle_ms and by the
+ * overall request deadline measured from start. Connections arriving in
+ * the meantime are moved into the queue, so they are counted from arrival
+ * and overflow is turned away at once. Returns 1 when ready, 0 on timeout. */
+static int wait_fd(int fd, int for_write, const struct timeval *start, long idle_ms) {
+    struct timeval waiting;
+    gettimeofday(&waiting, NULL);
+    while (1) {
+        long left = REQUEST_TIMEOUT_MS - elapsed_ms(start);
+        long idle_left = idle_ms - elapsed_ms(&waiting);
+        long wait = idle_left < left ? idle_left : left;
+        if (wait <= 0) {
+            return 0;
+        }
+        fd_set rfds;
+        fd_set wfds;
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        FD_SET(fd, for_write ? &wfds : &rfds);
+        int max_fd = fd;
+        if (queue.listen_fd >= 0) {
+            FD_SET(queue.listen_fd, &rfds);
+            if (queue.listen_fd > max_fd) {
+                max_fd = queue.listen_fd;
+            }
+        }
+        struct timeval tv;
+        tv.tv_sec = wait / 1000;
+        tv.tv_usec = (wait % 1000) * 1000L;
+        int ready = select(max_fd + 1, &rfds, &wfds, NULL, &tv);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (ready == 0) {
+            return 0;
+        }
+        if (queue.listen_fd >= 0 && FD_ISSET(queue.listen_fd, &rfds)) {
+            accept_pending();
+        }
+        if (FD_ISSET(fd, for_write ? &wfds : &rfds)) {
+            return 1;
+        }
+    }
+}
+
+/* recv() bounded by an idle timeout and by the overall request deadline
+ * measured from start. Returns IO_TIMED_OUT when either one expires. */
+static ssize_t recv_timed(int fd, void *buf, size_t len, const struct timeval *start, long idle_ms) {
+    int ready = wait_fd(fd, 0, start, idle_ms);
+    if (ready < 0) {
+        return -1;
+    }
+    if (ready == 0) {
+        return IO_TIMED_OUT;
+    }
+    return recv(fd, buf, len, 0);
+}
+
+/* send() bounded by BODY_IDLE_TIMEOUT_MS per call and by the overall
+ * request deadline, so a client reading a few bytes at a time cannot hold
+ * the server forever. With SO_SNDTIMEO the kernel enforces the idle limit
+ * and whole buffers go out at once; without it every SEND_CHUNK waits in
+ * select(). Returns IO_TIMED_OUT when either limit expires. */
+static int send_timed(int fd, const void *data, size_t len, const struct timeval *start) {
     const char *p = (const char *)data;
+    if (request_has_sndtimeo) {
+        /* SO_SNDTIMEO bounds each send(); only the deadline is checked here */
+        static struct timeval last_accept;
+        while (len > 0) {
+            if (elapsed_ms(start) >= REQUEST_TIMEOUT_MS) {
+                return IO_TIMED_OUT;
+            }
+            if (queue.listen_fd >= 0 && elapsed_ms(&last_accept) >= SEND_ACCEPT_POLL_MS) {
+                accept_pending();
+                gettimeofday(&last_accept, NULL);
+            }
+            ssize_t n = send(fd, p, len, 0);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return (errno == EAGAIN || errno == EWOULDBLOCK) ? IO_TIMED_OUT : -1;
+            }
+            p += (size_t)n;
+            len -= (size_t)n;
+        }
+        return 0;
+    }
     while (len > 0) {
-        ssize_t n = send(fd, p, len, 0);
-        if (n < 0) {
+        int ready = wait_fd(fd, 1, start, BODY_IDLE_TIMEOUT_MS);
+        if (ready < 0) {
             return -1;
         }
+        if (ready == 0) {
+            return IO_TIMED_OUT;
+        }
+        ssize_t n = send(fd, p, len > SEND_CHUNK ? SEND_CHUNK : len, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? IO_TIMED_OUT : -1;
+        }
         p += (size_t)n;
         len -= (size_t)n;
     }
     return 0;
 }
 
+static int send_all(int fd, const void *data, size_t len) {
+    int rc = send_timed(fd, data, len, &request_start);
+    if (rc == IO_TIMED_OUT && !request_timed_out) {
+        request_timed_out = 1;
+        stats.timed_out++;
+    }
+    return rc;
+}
+
 static void send_simple_response(int client_fd,
                                  int status,
                                  const char *reason,
@@ -150,6 +310,13 @@ static void send_internal_error(int client_fd) {
     send_simple_response(client_fd, 500, "Internal Server Error", "text/plain", "Internal Server Error\n");
 }
 
+static void send_request_timeout(int client_fd) {
+    stats.timed_out++;
+    request_timed_out = 1;
+    gettimeofday(&request_start, NULL); /* fresh budget for the 408 itself */
+    send_simple_response(client_fd, 408, "Request Timeout", "text/plain", "Request Timeout\n");
+}
+
 static void send_header_only(int client_fd,
                              int status,
                              const char *reason,
@@ -177,6 +344,75 @@ static void send_header_only(int client_fd,
     }
 }
 
+/* Reads and sorts a directory listing; the caller frees it with free_entries() */
+static int read_entries(const char *fs_path, struct entry **out, size_t *out_count) {
+    DIR *dir = opendir(fs_path);
+    if (dir == NULL) {
+        return -1;
+    }
+
+    struct entry *entries = NULL;
+    size_t entry_count = 0;
+    size_t entry_cap = 0;
+
+    struct dirent *entry = NULL;
+    while ((entry = readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+            continue;
+        }
+
+        char full_path[1024];
+        snprintf(full_path, sizeof(full_path), "%s/%s", fs_path, name);
+
+        struct stat st;
+        if (stat(full_path, &st) != 0) {
+            continue;
+        }
+
+        if (entry_count == entry_cap) {
+            size_t new_cap = entry_cap ? entry_cap * 2 : 32;
+            struct entry *tmp = (struct entry *)realloc(entries, new_cap * sizeof(struct entry));
+            if (!tmp) {
+                continue;
+            }
+            entries = tmp;
+            entry_cap = new_cap;
+        }
+
+        entries[entry_count].name = str_dup(name);
+        if (!entries[entry_count].name) {
+            continue;
+        }
+        entries[entry_count].is_dir = S_ISDIR(st.st_mode);
+        entries[entry_count].size = (long)st.st_size;
+        entry_count++;
+    }
+    closedir(dir);
+
+    if (entry_count > 1) {
+        qsort(entries, entry_count, sizeof(struct entry), entry_cmp);
+    }
+
+    *out = entries;
+    *out_count = entry_count;
+    return 0;
+}
+
+static void free_entries(struct entry *entries, size_t entry_count) {
+    for (size_t i = 0; i < entry_count; ++i) {
+        free(entries[i].name);
+    }
+    free(entries);
+}
+
+#if FEATURE_HTML_UI
+#if FEATURE_DELETE
+#define UI_DELETE_LINK " | <a href=\"/delete%.700s\">delete</a>"
+#else
+#define UI_DELETE_LINK "%.0s"
+#endif
+
 static void build_child_url(const char *base_url, const char *name, int is_dir, char *out, size_t out_sz) {
     const char *base = (base_url && base_url[0]) ? base_url : "/";
     size_t base_len = strlen(base);
@@ -220,8 +456,9 @@ static void serve_index(int client_fd, const char *url_path) {
         return;
     }
 
-    DIR *dir = opendir(fs_path);
-    if (dir == NULL) {
+    struct entry *entries = NULL;
+    size_t entry_count = 0;
+    if (read_entries(fs_path, &entries, &entry_count) != 0) {
         send_internal_error(client_fd);
         return;
     }
@@ -250,8 +487,10 @@ static void serve_index(int client_fd, const char *url_path) {
         "<div class=\"layout\">"
         "<div class=\"pane\">"
         "<h1>Falcon File Manager — %s</h1>"
+#if FEATURE_UPLOAD
         "<form id=\"upload-form\"><input type=\"file\" id=\"upload-file\"/>"
         "<button type=\"submit\">Upload</button></form>"
+#endif
         "<p>Listing directory: <code>%s</code></p>"
         "<table id=\"file-table\"><tr><th>Name</th><th>Size (bytes)</th><th>Actions</th></tr>";
     send_all(client_fd, header, strlen(header));
@@ -268,48 +507,6 @@ static void serve_index(int client_fd, const char *url_path) {
              parent);
     send_all(client_fd, parent_row, strlen(parent_row));
 
-    struct entry *entries = NULL;
-    size_t entry_count = 0;
-    size_t entry_cap = 0;
-
-    struct dirent *entry = NULL;
-    while ((entry = readdir(dir)) != NULL) {
-        const char *name = entry->d_name;
-        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
-            continue;
-        }
-
-        char full_path[1024];
-        snprintf(full_path, sizeof(full_path), "%s/%s", fs_path, name);
-
-        struct stat st;
-        if (stat(full_path, &st) != 0) {
-            continue;
-        }
-
-        if (entry_count == entry_cap) {
-            size_t new_cap = entry_cap ? entry_cap * 2 : 32;
-            struct entry *tmp = (struct entry *)realloc(entries, new_cap * sizeof(struct entry));
-            if (!tmp) {
-                continue;
-            }
-            entries = tmp;
-            entry_cap = new_cap;
-        }
-
-        entries[entry_count].name = str_dup(name);
-        if (!entries[entry_count].name) {
-            continue;
-        }
-        entries[entry_count].is_dir = S_ISDIR(st.st_mode);
-        entries[entry_count].size = (long)st.st_size;
-        entry_count++;
-    }
-    closedir(dir);
-
-    if (entry_count > 1) {
-        qsort(entries, entry_count, sizeof(struct entry), entry_cmp);
-    }
 
     for (size_t i = 0; i < entry_count; ++i) {
         const char *name = entries[i].name;
@@ -326,7 +523,7 @@ static void serve_index(int client_fd, const char *url_path) {
             build_child_url(current_url, name, 0, child_url, sizeof(child_url));
             snprintf(line,
                      sizeof(line),
-                     "<tr><td>%.200s</td><td>%ld</td><td><a href=\"/file%.700s\">download</a> | <a href=\"/delete%.700s\">delete</a></td></tr>",
+                     "<tr><td>%.200s</td><td>%ld</td><td><a href=\"/file%.700s\">download</a>" UI_DELETE_LINK "</td></tr>",
                      name,
                      entries[i].size,
                      child_url,
@@ -335,15 +532,15 @@ static void serve_index(int client_fd, const char *url_path) {
         send_all(client_fd, line, strlen(line));
     }
 
-    for (size_t i = 0; i < entry_count; ++i) {
-        free(entries[i].name);
-    }
-    free(entries);
+    free_entries(entries, entry_count);
 
     const char *footer =
         "</table>"
+#if FEATURE_UPLOAD
         "<p>Upload via form above nebo: <code>curl -T file.bin http://&lt;host&gt;/upload/path/file.bin</code></p>"
+#endif
         "</div>" /* pane */
+#if FEATURE_EXEC
         "<div class=\"pane\">"
         "<h2>Remote Terminal</h2>"
         "<div id=\"console-log\"></div>"
@@ -352,22 +549,62 @@ static void serve_index(int client_fd, const char *url_path) {
         "<button type=\"submit\">Run</button>"
         "</form>"
         "</div>" /* pane */
+#endif
         "</div>" /* layout */ 
         "<script>"
+#if FEATURE_UPLOAD
         "const form=document.getElementById('upload-form');"
         "const fileInput=document.getElementById('upload-file');"
         "const currentPath=document.body.dataset.path||'/';"
         "form.addEventListener('submit',async(e)=>{e.preventDefault();const f=fileInput.files[0];if(!f){alert('Vyberte soubor');return;}let base=currentPath.endsWith('/')?currentPath.slice(0,-1):currentPath;if(base===''){base='/';}const target=(base==='/'?'' : base)+'/'+encodeURIComponent(f.name);const res=await fetch('/upload'+target,{method:'PUT',body:f,headers:{'Content-Length':f.size}});if(res.ok){location.reload();}else{alert('Upload selhal: '+res.status);}});"
+#endif
+#if FEATURE_EXEC
         "const clog=document.getElementById('console-log');"
         "const cform=document.getElementById('console-form');"
         "const cinput=document.getElementById('console-input');"
         "function appendLog(text){clog.textContent+=text+'\\n';clog.scrollTop=clog.scrollHeight;}"
         "cform.addEventListener('submit',async(e)=>{e.preventDefault();const cmd=cinput.value.trim();if(!cmd){return;}appendLog('> '+cmd);cinput.value='';const body=new TextEncoder().encode(cmd);const res=await fetch('/exec',{method:'POST',body:body,headers:{'Content-Length':body.length}});const txt=await res.text();appendLog(txt);});"
+#endif
         "document.getElementById('file-table').addEventListener('click',(e)=>{const a=e.target.closest('a');if(!a){return;}const href=a.getAttribute('href');if(!href){return;}e.preventDefault();window.location.href=href;});"
         "</script>"
         "</body></html>";
     send_all(client_fd, footer, strlen(footer));
 }
+#else
+static void serve_index(int client_fd, const char *url_path) {
+    char fs_path[512];
+    if (normalize_path(url_path, fs_path, sizeof(fs_path)) != 0) {
+        send_bad_request(client_fd, "Invalid path\n");
+        return;
+    }
+
+    struct entry *entries = NULL;
+    size_t entry_count = 0;
+    if (read_entries(fs_path, &entries, &entry_count) != 0) {
+        send_internal_error(client_fd);
+        return;
+    }
+
+    /* Plain listing for API clients: "name<TAB>size", directories end in '/' */
+    const char *header =
+        "HTTP/1.0 200 OK\r\n"
+        "Server: " SERVER_NAME "\r\n"
+        "Content-Type: text/plain\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+    send_all(client_fd, header, strlen(header));
+    char line[320];
+    for (size_t i = 0; i < entry_count; ++i) {
+        if (entries[i].is_dir) {
+            snprintf(line, sizeof(line), "%.255s/\t-\n", entries[i].name);
+        } else {
+            snprintf(line, sizeof(line), "%.255s\t%ld\n", entries[i].name, entries[i].size);
+        }
+        send_all(client_fd, line, strlen(line));
+    }
+    free_entries(entries, entry_count);
+}
+#endif /* FEATURE_HTML_UI */
 
 static void serve_file(int client_fd, const char *path) {
     char fs_path[512];
@@ -402,7 +639,7 @@ static void serve_file(int client_fd, const char *path) {
                              disp_name);
     send_header_only(client_fd, 200, "OK", "application/octet-stream", (unsigned long)st.st_size, dispo_len > 0 ? dispo : "");
 
-    char buffer[4096];
+    char buffer[IO_BUF_SIZE];
     ssize_t n = 0;
     while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
         if (send_all(client_fd, buffer, (size_t)n) != 0) {
@@ -412,6 +649,7 @@ static void serve_file(int client_fd, const char *path) {
     close(fd);
 }
 
+#if FEATURE_DELETE
 static void handle_delete(int client_fd, const char *name) {
     char fs_path[512];
     if (normalize_path(name, fs_path, sizeof(fs_path)) != 0 || strcmp(fs_path, ".") == 0) {
@@ -431,7 +669,200 @@ static void handle_delete(int client_fd, const char *name) {
     }
     send_simple_response(client_fd, 200, "OK", "text/plain", "Deleted\n");
 }
+#endif
+
+#if FEATURE_TAIL
+static int query_param(const char *query, const char *key, char *out, size_t out_sz) {
+    size_t key_len = strlen(key);
+    const char *p = query;
+    while (p && *p) {
+        const char *amp = strchr(p, '&');
+        size_t pair_len = amp ? (size_t)(amp - p) : strlen(p);
+        if (pair_len > key_len && strncmp(p, key, key_len) == 0 && p[key_len] == '=') {
+            size_t val_len = pair_len - key_len - 1;
+            if (val_len >= out_sz) {
+                val_len = out_sz - 1;
+            }
+            memcpy(out, p + key_len + 1, val_len);
+            out[val_len] = '\0';
+            return 1;
+        }
+        if (pair_len == key_len && strncmp(p, key, key_len) == 0) {
+            out[0] = '\0';
+            return 1;
+        }
+        p = amp ? amp + 1 : NULL;
+    }
+    return 0;
+}
+
+static int send_chunk(int client_fd, const void *data, size_t len) {
+    char size_line[16];
+    int size_len = snprintf(size_line, sizeof(size_line), "%lx\r\n", (unsigned long)len);
+    if (size_len <= 0) {
+        return -1;
+    }
+    if (send_all(client_fd, size_line, (size_t)size_len) != 0 || send_all(client_fd, data, len) != 0) {
+        return -1;
+    }
+    return send_all(client_fd, "\r\n", 2);
+}
+
+/* Sends bytes [*offset, end) of fd, either raw or as HTTP chunks, and
+ * advances *offset past whatever was actually sent. */
+static int send_file_range(int client_fd, int fd, long *offset, long end, int chunked) {
+    if (lseek(fd, (off_t)*offset, SEEK_SET) < 0) {
+        return -1;
+    }
+    char buffer[IO_BUF_SIZE];
+    while (*offset < end) {
+        long remaining = end - *offset;
+        size_t to_read = (size_t)((remaining > (long)sizeof(buffer)) ? (long)sizeof(buffer) : remaining);
+        ssize_t n = read(fd, buffer, to_read);
+        if (n <= 0) {
+            break;
+        }
+        int rc = chunked ? send_chunk(client_fd, buffer, (size_t)n) : send_all(client_fd, buffer, (size_t)n);
+        if (rc != 0) {
+            return -1;
+        }
+        *offset += (long)n;
+    }
+    return 0;
+}
+
+/* Follow mode streams with chunked encoding for HTTP/1.1 clients. HTTP/1.0
+ * clients get the raw bytes instead and the body ends when we close. */
+static void serve_tail(int client_fd, const char *path, const char *query, int chunked) {
+    char fs_path[512];
+    if (normalize_path(path, fs_path, sizeof(fs_path)) != 0 || strcmp(fs_path, ".") == 0) {
+        send_bad_request(client_fd, "Invalid filename\n");
+        return;
+    }
+
+    long from = 0;
+    int follow = 0;
+    char value[32];
+    if (query_param(query, "from", value, sizeof(value))) {
+        char *end = NULL;
+        from = strtol(value, &end, 10);
+        if (end == value || *end != '\0') {
+            send_bad_request(client_fd, "Invalid from offset\n");
+            return;
+        }
+    }
+    if (query_param(query, "follow", value, sizeof(value))) {
+        follow = strcmp(value, "0") != 0;
+    }
+
+    int fd = open(fs_path, O_RDONLY);
+    if (fd < 0) {
+        send_not_found(client_fd);
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        send_not_found(client_fd);
+        return;
+    }
+
+    /* Negative offsets count back from the current end, like tail -c. An
+     * offset past the end means the file shrank since the client last saw
+     * it, so start over; X-Tail-Offset: 0 tells the client so. */
+    long size = (long)st.st_size;
+    long offset = from < 0 ? size + from : from;
+    if (offset < 0 || offset > size) {
+        offset = 0;
+    }
+
+    char extra[64];
+    snprintf(extra, sizeof(extra), "X-Tail-Offset: %ld\r\n", offset);
+
+    if (!follow) {
+        send_header_only(client_fd, 200, "OK", "text/plain", (unsigned long)(size - offset), extra);
+        send_file_range(client_fd, fd, &offset, size, 0);
+        close(fd);
+        return;
+    }
+
+    char header[256];
+    int header_len = snprintf(header,
+                              sizeof(header),
+                              "HTTP/1.%d 200 OK\r\n"
+                              "Server: %s\r\n"
+                              "Content-Type: text/plain\r\n"
+                              "%s"
+                              "Cache-Control: no-cache\r\n"
+                              "Connection: close\r\n"
+                              "%s"
+                              "\r\n",
+                              chunked ? 1 : 0,
+                              SERVER_NAME,
+                              chunked ? "Transfer-Encoding: chunked\r\n" : "",
+                              extra);
+    if (header_len <= 0 || send_all(client_fd, header, (size_t)header_len) != 0) {
+        close(fd);
+        return;
+    }
+
+    time_t give_up = time(NULL) + TAIL_MAX_HOLD_SEC;
+    while (1) {
+        if (fstat(fd, &st) != 0) {
+            break;
+        }
+        size = (long)st.st_size;
+        if (size < offset) {
+            break; /* truncated: the reconnect gets a fresh X-Tail-Offset */
+        }
+        if (size > offset && send_file_range(client_fd, fd, &offset, size, chunked) != 0) {
+            close(fd);
+            return;
+        }
+        /* Give way as soon as anyone else is waiting; the client resumes
+         * with from=<X-Tail-Offset + bytes received>. */
+        if (time(NULL) >= give_up || queue.count > 0) {
+            break;
+        }
+
+        /* Wait for the next poll, but notice if the client hangs up meanwhile */
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(client_fd, &rfds);
+        int max_fd = client_fd;
+        if (queue.listen_fd >= 0) {
+            FD_SET(queue.listen_fd, &rfds);
+            if (queue.listen_fd > max_fd) {
+                max_fd = queue.listen_fd;
+            }
+        }
+        struct timeval tv;
+        tv.tv_sec = TAIL_POLL_INTERVAL_MS / 1000;
+        tv.tv_usec = (TAIL_POLL_INTERVAL_MS % 1000) * 1000L;
+        int ready = select(max_fd + 1, &rfds, NULL, NULL, &tv);
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+        if (ready > 0 && queue.listen_fd >= 0 && FD_ISSET(queue.listen_fd, &rfds)) {
+            break;
+        }
+        if (ready > 0 && FD_ISSET(client_fd, &rfds)) {
+            char discard[64];
+            if (recv(client_fd, discard, sizeof(discard), 0) <= 0) {
+                close(fd);
+                return;
+            }
+        }
+    }
+    close(fd);
+    if (chunked) {
+        send_all(client_fd, "0\r\n\r\n", 5);
+    }
+}
+#endif
 
+#if FEATURE_UPLOAD || FEATURE_EXEC
 static long parse_content_length(const char *headers, size_t header_len) {
     const char *p = headers;
     const char *end = headers + header_len;
@@ -455,12 +886,22 @@ static long parse_content_length(const char *headers, size_t header_len) {
     }
     return -1;
 }
-
-static ssize_t read_request(int client_fd, char *buffer, size_t buf_size, size_t *header_len, char **body_start) {
+#endif
+
+static ssize_t read_request(int client_fd,
+                            char *buffer,
+                            size_t buf_size,
+                            size_t *header_len,
+                            char **body_start,
+                            const struct timeval *start) {
     size_t total = 0;
     int found = 0;
     while (total < buf_size) {
-        ssize_t n = recv(client_fd, buffer + total, buf_size - total, 0);
+        long idle = HEADER_TIMEOUT_MS - elapsed_ms(start);
+        ssize_t n = recv_timed(client_fd, buffer + total, buf_size - total, start, idle);
+        if (n == IO_TIMED_OUT) {
+            return IO_TIMED_OUT;
+        }
         if (n <= 0) {
             return -1;
         }
@@ -482,14 +923,23 @@ static ssize_t read_request(int client_fd, char *buffer, size_t buf_size, size_t
         if (found) {
             break;
         }
+        if (total >= MAX_HEADER_SIZE) {
+            return RECV_TOO_LARGE;
+        }
     }
-    if (!found) {
-        return -1;
+    if (!found || *header_len > MAX_HEADER_SIZE) {
+        return RECV_TOO_LARGE;
     }
     return (ssize_t)total;
 }
 
-static void handle_upload(int client_fd, const char *name, const char *initial_body, size_t initial_len, long content_length) {
+#if FEATURE_UPLOAD
+static void handle_upload(int client_fd,
+                          const char *name,
+                          const char *initial_body,
+                          size_t initial_len,
+                          long content_length,
+                          const struct timeval *start) {
     char fs_path[512];
     if (normalize_path(name, fs_path, sizeof(fs_path)) != 0 || strcmp(fs_path, ".") == 0) {
         send_bad_request(client_fd, "Invalid filename\n");
@@ -516,11 +966,20 @@ static void handle_upload(int client_fd, const char *name, const char *initial_b
         written += (long)initial_len;
     }
 
-    char buf[4096];
+    char buf[IO_BUF_SIZE];
+    struct timeval body_start;
+    gettimeofday(&body_start, NULL);
     while (written < content_length) {
         long remaining = content_length - written;
         size_t to_read = (size_t)((remaining > (long)sizeof(buf)) ? (long)sizeof(buf) : remaining);
-        ssize_t n = recv(client_fd, buf, to_read, 0);
+        ssize_t n = recv_timed(client_fd, buf, to_read, start, BODY_IDLE_TIMEOUT_MS);
+        long body_ms = elapsed_ms(&body_start);
+        if (n == IO_TIMED_OUT ||
+            (body_ms > UPLOAD_GRACE_MS && written < UPLOAD_MIN_BYTES_PER_SEC * (body_ms / 1000L))) {
+            close(fd);
+            send_request_timeout(client_fd);
+            return;
+        }
         if (n <= 0) {
             close(fd);
             send_internal_error(client_fd);
@@ -537,8 +996,88 @@ static void handle_upload(int client_fd, const char *name, const char *initial_b
     close(fd);
     send_simple_response(client_fd, 201, "Created", "text/plain", "Uploaded\n");
 }
+#endif
+
+#if FEATURE_EXEC
+/* Runs cmd through /bin/sh with stdout on a pipe and stdin on /dev/null, in
+ * its own process group so a timeout can kill the whole pipeline. The child
+ * drops every server socket, so background jobs cannot keep the client's
+ * connection open. Returns the read end of the pipe, or -1. */
+static int spawn_command(int client_fd, const char *cmd, pid_t *pid_out) {
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0) {
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        setpgid(0, 0);
+        close(client_fd);
+        if (queue.listen_fd >= 0) {
+            close(queue.listen_fd);
+        }
+        for (size_t i = 0; i < queue.count; ++i) {
+            close(queue.items[(queue.head + i) % MAX_QUEUED_CONNS].fd);
+        }
+        int null_fd = open("/dev/null", O_RDONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, 0);
+            close(null_fd);
+        }
+        dup2(pipe_fds[1], 1);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+        _exit(127);
+    }
+    close(pipe_fds[1]);
+    *pid_out = pid;
+    return pipe_fds[0];
+}
+
+static void stop_command(pid_t pid) {
+    if (kill(-pid, SIGKILL) != 0) {
+        kill(pid, SIGKILL);
+    }
+}
+
+/* Waits for the command to exit, killing it once EXEC_TIMEOUT_MS has passed
+ * (it may have closed stdout and kept running). New connections keep being
+ * queued meanwhile. Returns -1 if it had to kill. */
+static int reap_command(pid_t pid, const struct timeval *exec_start) {
+    int killed = 0;
+    while (1) {
+        pid_t r = waitpid(pid, NULL, WNOHANG);
+        if (r != 0 && !(r < 0 && errno == EINTR)) {
+            return killed ? -1 : 0;
+        }
+        if (!killed && elapsed_ms(exec_start) >= EXEC_TIMEOUT_MS) {
+            stop_command(pid);
+            killed = 1;
+        }
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        if (queue.listen_fd >= 0) {
+            FD_SET(queue.listen_fd, &rfds);
+        }
+        struct timeval tv;
+        tv.tv_sec = 0;
+        tv.tv_usec = 20000L;
+        if (select(queue.listen_fd + 1, &rfds, NULL, NULL, &tv) > 0 && FD_ISSET(queue.listen_fd, &rfds)) {
+            accept_pending();
+        }
+    }
+}
 
-static void handle_exec(int client_fd, const char *initial_body, size_t initial_len, long content_length) {
+static void handle_exec(int client_fd,
+                        const char *initial_body,
+                        size_t initial_len,
+                        long content_length,
+                        const struct timeval *start) {
     const long MAX_CMD = 4096;
     if (content_length < 0 || content_length > MAX_CMD) {
         send_bad_request(client_fd, "Content-Length missing or too large\n");
@@ -550,7 +1089,11 @@ static void handle_exec(int client_fd, const char *initial_body, size_t initial_
     memcpy(cmd_buf, initial_body, have);
 
     while ((long)have < content_length) {
-        ssize_t n = recv(client_fd, cmd_buf + have, (size_t)(content_length - (long)have), 0);
+        ssize_t n = recv_timed(client_fd, cmd_buf + have, (size_t)(content_length - (long)have), start, BODY_IDLE_TIMEOUT_MS);
+        if (n == IO_TIMED_OUT) {
+            send_request_timeout(client_fd);
+            return;
+        }
         if (n <= 0) {
             send_internal_error(client_fd);
             return;
@@ -559,38 +1102,61 @@ static void handle_exec(int client_fd, const char *initial_body, size_t initial_
     }
     cmd_buf[have < (size_t)MAX_CMD ? have : (size_t)MAX_CMD] = '\0';
 
-    FILE *fp = popen(cmd_buf, "r");
-    if (!fp) {
+    const size_t MAX_OUT = EXEC_MAX_OUTPUT;
+    char *out = (char *)malloc(MAX_OUT + 16);
+    if (!out) {
         send_internal_error(client_fd);
         return;
     }
 
-    const size_t MAX_OUT = 65536;
-    char *out = (char *)malloc(MAX_OUT + 1);
-    if (!out) {
-        pclose(fp);
+    pid_t pid = 0;
+    int out_fd = spawn_command(client_fd, cmd_buf, &pid);
+    if (out_fd < 0) {
+        free(out);
         send_internal_error(client_fd);
         return;
     }
 
+    struct timeval exec_start;
+    gettimeofday(&exec_start, NULL);
     size_t total = 0;
+    int timed_out = 0;
     while (total < MAX_OUT) {
-        size_t space = MAX_OUT - total;
-        size_t nread = fread(out + total, 1, space, fp);
-        if (nread == 0) {
+        long left = EXEC_TIMEOUT_MS - elapsed_ms(&exec_start);
+        int ready = left > 0 ? wait_fd(out_fd, 0, start, left) : 0;
+        if (ready == 0) {
+            timed_out = 1;
+            break;
+        }
+        if (ready < 0) {
             break;
         }
-        total += nread;
+        ssize_t n = read(out_fd, out + total, MAX_OUT - total);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        total += (size_t)n;
     }
-    int hit_eof = feof(fp);
-    pclose(fp);
+    close(out_fd);
 
-    int truncated = (total == MAX_OUT && !hit_eof);
-    if (truncated && total + 12 < MAX_OUT + 1) {
-        const char *suffix = "\n[truncated]";
-        size_t s_len = strlen(suffix);
-        memcpy(out + total, suffix, s_len);
-        total += s_len;
+    int truncated = total == MAX_OUT;
+    if (truncated || timed_out) {
+        stop_command(pid);
+    }
+    if (reap_command(pid, &exec_start) != 0) {
+        timed_out = 1;
+    }
+
+    const char *suffix = timed_out ? "\n[timed out]" : (truncated ? "\n[truncated]" : "");
+    size_t s_len = strlen(suffix);
+    memcpy(out + total, suffix, s_len);
+    total += s_len;
+    if (timed_out && !request_timed_out) {
+        request_timed_out = 1;
+        stats.timed_out++;
     }
     send_header_only(client_fd, 200, "OK", "text/plain", (unsigned long)total, "");
     if (total > 0) {
@@ -598,56 +1164,174 @@ static void handle_exec(int client_fd, const char *initial_body, size_t initial_
     }
     free(out);
 }
+#endif
+
+#if FEATURE_STATS
+static void serve_stats(int client_fd) {
+    char body[256];
+    snprintf(body,
+             sizeof(body),
+             "accepted %lu\n"
+             "served %lu\n"
+             "timed_out %lu\n"
+             "rejected %lu\n"
+             "queued %lu\n",
+             stats.accepted,
+             stats.served,
+             stats.timed_out,
+             stats.rejected,
+             (unsigned long)queue.count);
+    send_simple_response(client_fd, 200, "OK", "text/plain", body);
+}
+#endif
 
 static void handle_client(int client_fd) {
     char buffer[RECV_BUF_SIZE];
     size_t header_len = 0;
     char *body_start = NULL;
+    gettimeofday(&request_start, NULL);
+    request_timed_out = 0;
 
-    ssize_t total = read_request(client_fd, buffer, sizeof(buffer), &header_len, &body_start);
+    ssize_t total = read_request(client_fd, buffer, sizeof(buffer), &header_len, &body_start, &request_start);
+    if (total == IO_TIMED_OUT) {
+        send_request_timeout(client_fd);
+        return;
+    }
+    if (total == RECV_TOO_LARGE) {
+        stats.rejected++;
+        send_simple_response(client_fd, 431, "Request Header Fields Too Large", "text/plain", "Request Header Fields Too Large\n");
+        return;
+    }
     if (total <= 0) {
         return;
     }
+    stats.served++;
 
     buffer[header_len] = '\0'; /* terminate headers for parsing */
 
     char method[8] = {0};
     char path[512] = {0};
-    if (sscanf(buffer, "%7s %511s", method, path) != 2) {
+    char version[16] = {0};
+    if (sscanf(buffer, "%7s %511s %15s", method, path, version) < 2) {
         send_bad_request(client_fd, NULL);
         return;
     }
 
+    char *query = strchr(path, '?');
+    if (query) {
+        *query++ = '\0';
+    }
+
+#if FEATURE_UPLOAD || FEATURE_EXEC
     const char *body = body_start;
     size_t body_len = (size_t)(total - (body_start - buffer));
+#endif
 
     if (strcasecmp(method, "GET") == 0) {
         if (strncmp(path, "/file/", 6) == 0) {
             serve_file(client_fd, path + 6);
+#if FEATURE_DELETE
         } else if (strncmp(path, "/delete/", 8) == 0) {
             handle_delete(client_fd, path + 8);
+#endif
+#if FEATURE_TAIL
+        } else if (strncmp(path, "/api/tail/", 10) == 0) {
+            serve_tail(client_fd, path + 10, query, strcmp(version, "HTTP/1.1") == 0);
+#endif
+#if FEATURE_STATS
+        } else if (strcmp(path, "/api/stats") == 0) {
+            serve_stats(client_fd);
+#endif
         } else {
             serve_index(client_fd, path);
         }
     } else if (strcasecmp(method, "PUT") == 0) {
+#if FEATURE_UPLOAD
         if (strncmp(path, "/upload/", 8) == 0) {
             long content_length = parse_content_length(buffer, header_len);
-            handle_upload(client_fd, path + 8, body, body_len, content_length);
-        } else {
-            send_not_found(client_fd);
+            handle_upload(client_fd, path + 8, body, body_len, content_length, &request_start);
+            return;
         }
+#endif
+        send_not_found(client_fd);
     } else if (strcasecmp(method, "POST") == 0) {
+#if FEATURE_EXEC
         if (strcmp(path, "/exec") == 0) {
             long content_length = parse_content_length(buffer, header_len);
-            handle_exec(client_fd, body, body_len, content_length);
-        } else {
-            send_not_found(client_fd);
+            handle_exec(client_fd, body, body_len, content_length, &request_start);
+            return;
         }
+#endif
+        send_not_found(client_fd);
     } else {
         send_method_not_allowed(client_fd);
     }
 }
 
+static void reject_connection(int client_fd) {
+    static const char response[] =
+        "HTTP/1.0 503 Service Unavailable\r\n"
+        "Server: " SERVER_NAME "\r\n"
+        "Content-Type: text/plain\r\n"
+        "Content-Length: 5\r\n"
+        "Retry-After: 1\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+        "Busy\n";
+    stats.rejected++;
+    /* A fresh socket has room for this; no select() so accept_pending()
+     * is never re-entered from here */
+    send(client_fd, response, sizeof(response) - 1, 0);
+    close(client_fd);
+}
+
+/* Moves every connection the kernel has ready into the FIFO without
+ * blocking. Whatever does not fit is turned away immediately. */
+static void accept_pending(void) {
+    while (1) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int client_fd = accept(queue.listen_fd, (struct sockaddr *)&client_addr, &client_len);
+        if (client_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept");
+            }
+            return;
+        }
+        stats.accepted++;
+
+        /* Some stacks let accepted sockets inherit O_NONBLOCK from the listener */
+        int flags = fcntl(client_fd, F_GETFL, 0);
+        if (flags >= 0) {
+            fcntl(client_fd, F_SETFL, flags & ~O_NONBLOCK);
+        }
+        /* Bounds blocking sends so send_timed() can write whole buffers;
+         * where the stack lacks it, send_timed() selects per SEND_CHUNK */
+        static int sndtimeo_warned = 0;
+        struct timeval snd_timeout;
+        snd_timeout.tv_sec = BODY_IDLE_TIMEOUT_MS / 1000;
+        snd_timeout.tv_usec = (BODY_IDLE_TIMEOUT_MS % 1000) * 1000L;
+        int has_sndtimeo = setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &snd_timeout, sizeof(snd_timeout)) == 0;
+        if (!has_sndtimeo && !sndtimeo_warned) {
+            perror("setsockopt SO_SNDTIMEO");
+            sndtimeo_warned = 1;
+        }
+
+        if (queue.count == MAX_QUEUED_CONNS) {
+            reject_connection(client_fd);
+            continue;
+        }
+        struct pending_conn *slot = &queue.items[(queue.head + queue.count) % MAX_QUEUED_CONNS];
+        slot->fd = client_fd;
+        slot->has_sndtimeo = has_sndtimeo;
+        gettimeofday(&slot->accepted_at, NULL);
+        queue.count++;
+    }
+}
+
 int main(void) {
     signal(SIGPIPE, SIG_IGN);
 
@@ -688,16 +1372,40 @@ int main(void) {
 
     printf("Serving on port %d\n", LISTEN_PORT);
 
+    int listen_flags = fcntl(server_fd, F_GETFL, 0);
+    if (listen_flags < 0 || fcntl(server_fd, F_SETFL, listen_flags | O_NONBLOCK) < 0) {
+        perror("fcntl");
+        close(server_fd);
+        return EXIT_FAILURE;
+    }
+    queue.listen_fd = server_fd;
+
     while (1) {
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-        int client_fd = accept(server_fd, (struct sockaddr *)&client_addr, &client_len);
-        if (client_fd < 0) {
-            perror("accept");
+        if (queue.count == 0) {
+            fd_set rfds;
+            FD_ZERO(&rfds);
+            FD_SET(server_fd, &rfds);
+            if (select(server_fd + 1, &rfds, NULL, NULL, NULL) < 0 && errno != EINTR) {
+                perror("select");
+            }
+        }
+        accept_pending();
+        if (queue.count == 0) {
             continue;
         }
-        handle_client(client_fd);
-        close(client_fd);
+
+        struct pending_conn next = queue.items[queue.head];
+        queue.head = (queue.head + 1) % MAX_QUEUED_CONNS;
+        queue.count--;
+
+        /* The client has likely given up already; answer fast instead */
+        if (elapsed_ms(&next.accepted_at) > MAX_QUEUE_WAIT_MS) {
+            reject_connection(next.fd);
+            continue;
+        }
+        request_has_sndtimeo = next.has_sndtimeo;
+        handle_client(next.fd);
+        close(next.fd);
     }
 
     close(server_fd);
@@ -0,0 +1,81 @@
+# Deepest call chain from main() in a gcc -fcallgraph-info=su dump (.ci).
+#
+# Functions compiled here carry their frame size. Library functions (libc,
+# MiNTlib) carry none, so their stack use is covered by a fixed margin
+# passed in as -v margin=<bytes>. Calls through function pointers (the
+# qsort() comparator) are not in the graph.
+
+function field(line, key,    s) {
+    if (!match(line, key ": \"[^\"]*\"")) {
+        return ""
+    }
+    return substr(line, RSTART + length(key) + 3, RLENGTH - length(key) - 4)
+}
+
+function short_name(title,    s) {
+    s = title
+    sub(/^.*:/, "", s)
+    return s
+}
+
+function deepest(n,    parts, cnt, i, d, best, best_kid) {
+    if (n in memo) {
+        return memo[n]
+    }
+    if (n in active) {
+        recursive = 1
+        return 0
+    }
+    active[n] = 1
+    best = 0
+    best_kid = ""
+    cnt = split(kids[n], parts, SUBSEP)
+    for (i = 2; i <= cnt; i++) {
+        d = deepest(parts[i])
+        if (d > best || best_kid == "") {
+            best = d
+            best_kid = parts[i]
+        }
+    }
+    delete active[n]
+    memo[n] = frame[n] + best
+    next_in_chain[n] = best_kid
+    return memo[n]
+}
+
+/^node:/ {
+    title = field($0, "title")
+    label = field($0, "label")
+    frame[title] = match(label, /[0-9]+ bytes/) ? substr(label, RSTART, RLENGTH) + 0 : 0
+}
+
+/^edge:/ {
+    src = field($0, "sourcename")
+    dst = field($0, "targetname")
+    if (!((src, dst) in seen)) {
+        seen[src, dst] = 1
+        kids[src] = kids[src] SUBSEP dst
+    }
+}
+
+END {
+    for (t in frame) {
+        if (t == "main" || t ~ /:main$/) {
+            root = t
+        }
+    }
+    if (root == "") {
+        print "stack: main() not found in call graph"
+        exit 1
+    }
+    peak = deepest(root)
+    chain = ""
+    for (n = root; n != ""; n = next_in_chain[n]) {
+        chain = chain (chain == "" ? "" : " > ") short_name(n)
+    }
+    printf "stack: deepest own chain %d bytes: %s\n", peak, chain
+    printf "stack: peak estimate %d bytes (chain + %d bytes libc margin)\n", peak + margin, margin
+    if (recursive) {
+        print "stack: warning: recursion in call graph, estimate is not a bound"
+    }
+}